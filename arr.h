@@ -68,6 +68,18 @@ barr_item barr_push(struct barr *arr, barr_item val);
 size_t barr_size(struct barr *arr);
 size_t barr_ensure(struct barr *arr, size_t size);
 
+#ifdef BREAD_STATS
+// Counters for every array in the program, see the README.
+struct barr_stats {
+	unsigned long long grows;  // calls to barr_grow
+	unsigned long long allocs; // buckets allocated
+	unsigned long long frees;  // buckets freed
+	unsigned long long bytes;  // bytes allocated for buckets
+	unsigned long long hops;   // buckets walked past while looking up an index
+};
+void barr_stats(struct barr_stats *out);
+#endif
+
 #endif // BREAD_ARR_H
 
 #ifdef BREAD_ARR_IMPLEMENTATION
@@ -93,6 +105,21 @@ size_t barr_ensure(struct barr *arr, size_t size);
 #define BARR_FREE free
 #endif
 
+#ifndef BREAD_TRACE
+#define BREAD_TRACE(name, n) ((void)0)
+#endif
+
+#ifdef BREAD_STATS
+static struct barr_stats barr_counters;
+#define BARR_STAT(field, n) (barr_counters.field += (n))
+
+void barr_stats(struct barr_stats *out) {
+	*out = barr_counters;
+}
+#else
+#define BARR_STAT(field, n) ((void)0)
+#endif
+
 struct barr *barr_new(size_t size) {
 	struct barr *arr = BARR_MALLOC(sizeof(struct barr));
 	arr->base   = NULL;
@@ -111,9 +138,13 @@ static size_t barr_grow(struct barr *arr) {
 	else
 #endif
 	{ l2 = BARR_GF * l1; } // WARN: the {}s are a footgun safety measure
+	BARR_STAT(grows, 1);
 	struct barr_node *node =
 		BARR_MALLOC(sizeof(struct barr) + sizeof(barr_item) * l2);
 	if (!node) return 0;
+	BARR_STAT(allocs, 1);
+	BARR_STAT(bytes, sizeof(struct barr) + sizeof(barr_item) * l2);
+	BREAD_TRACE("barr_grow", l2);
 	node->size  = l2;
 	node->next  = arr->base;
 	arr->base   = node;
@@ -144,6 +175,7 @@ static barr_item *barr_addr(struct barr *arr, size_t idx) {
 		if (!node) return NULL;
 		idx -= node->size;
 		node = node->next;
+		BARR_STAT(hops, 1);
 	}
 	return node->items + idx;
 }
@@ -173,7 +205,9 @@ barr_item barr_pop(struct barr *arr) {
 	arr->base = old->next;
 	arr->offset = 0;
 	arr->size--;
+	BREAD_TRACE("barr_free", old->size);
 	BARR_FREE(old);
+	BARR_STAT(frees, 1);
 	return popped;
 }
 
@@ -23,6 +23,17 @@ size_t ubd64ss(FILE *dst, FILE *src);
 // buffer -> stream
 size_t bd64bs(FILE *dst, const char *src, size_t n);
 size_t ubd64bs(FILE *dst, const char *src, size_t n);
+
+#ifdef BREAD_STATS
+// Counters for every call in the program, see the README.
+struct b64_stats {
+	unsigned long long calls;  // encoder and decoder calls
+	unsigned long long bytes;  // bytes processed, as returned by them
+	unsigned long long errors; // invalid chunks seen by the decoders
+	unsigned long long ns;     // time spent in them
+};
+void b64_stats(struct b64_stats *out);
+#endif
 #endif // BREAD_BASE64_H
 
 // = implementation
@@ -35,6 +46,43 @@ size_t ubd64bs(FILE *dst, const char *src, size_t n);
 #include <stdint.h>
 #include <string.h>
 
+#ifndef BREAD_TRACE
+#define BREAD_TRACE(name, n) ((void)0)
+#endif
+
+#ifdef BREAD_STATS
+#include <time.h>
+static struct b64_stats b64_counters;
+
+static unsigned long long b64_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// count a finished call, passing its result through
+static size_t b64_done(const char *name, unsigned long long start, size_t proc) {
+	b64_counters.calls++;
+	b64_counters.bytes += proc;
+	b64_counters.ns    += b64_now() - start;
+	(void)name; // unused unless BREAD_TRACE is defined
+	BREAD_TRACE(name, proc);
+	return proc;
+}
+
+void b64_stats(struct b64_stats *out) {
+	*out = b64_counters;
+}
+
+#define B64_BEGIN() unsigned long long b64_start = b64_now()
+#define B64_DONE(name, proc) b64_done(name, b64_start, proc)
+#define B64_STAT(field, n) (b64_counters.field += (n))
+#else
+#define B64_BEGIN() ((void)0)
+#define B64_DONE(name, proc) (BREAD_TRACE(name, proc), (proc))
+#define B64_STAT(field, n) ((void)0)
+#endif
+
 static const char b64a[] = {
 	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
 	'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
@@ -97,14 +145,17 @@ static inline size_t abd64c(char dst[static 3], const char _src[static 4], const
 	src[3] = idxof(src[3], alph);
 	if (src[0] == -2 || src[1] == -2 || src[2] == -2 || src[3] == -2) {
 		errno = EBB64AL;
+		B64_STAT(errors, 1);
 		return 0;
 	}
 	if (src[0] == -1 || src[1] == -1) {
 		errno = EBB64DE;
+		B64_STAT(errors, 1);
 		return 0;
 	}
 	if (src[2] == -1 && src[3] != -1) {
 		errno = EBB64DE;
+		B64_STAT(errors, 1);
 		return 0;
 	}
 
@@ -137,6 +188,7 @@ static inline int abe64cs(FILE *dst,
 
 // encode stream with alphabet
 inline static size_t abe64ss(FILE *dst, FILE *src, const char alph[static 64]) {
+	B64_BEGIN();
 	size_t proc = 0;
 	uint32_t buf = 0;
 	char obuf[4];
@@ -153,7 +205,7 @@ inline static size_t abe64ss(FILE *dst, FILE *src, const char alph[static 64]) {
 		if (r != 3) buf <<= 8;
 	}
 	abe64cs(dst, obuf, buf, r, alph);
-	return proc;
+	return B64_DONE("be64ss", proc);
 }
 
 size_t be64ss(FILE *dst, FILE *src) {
@@ -166,6 +218,7 @@ size_t ube64ss(FILE *dst, FILE *src) {
 
 // encode buffer with alphabet
 inline static size_t abe64bs(FILE *dst, const char *src, size_t n, const char alph[static 64]) {
+	B64_BEGIN();
 	size_t proc = 0;
 	uint32_t buf = 0;
 	char obuf[4];
@@ -180,7 +233,7 @@ inline static size_t abe64bs(FILE *dst, const char *src, size_t n, const char al
 		if (r != 3) buf <<= 8;
 	}
 	abe64cs(dst, obuf, buf, r, alph);
-	return proc;
+	return B64_DONE("be64bs", proc);
 }
 
 size_t be64bs(FILE *dst, const char *src, size_t n) {
@@ -193,6 +246,7 @@ size_t ube64bs(FILE *dst, const char *src, size_t n) {
 
 // decode stream with alphabet
 inline static size_t abd64ss(FILE *dst, FILE *src, const char alph[static 64]) {
+	B64_BEGIN();
 	size_t proc = 0;
 	char buf[4];
 	char out[3];
@@ -211,20 +265,21 @@ inline static size_t abd64ss(FILE *dst, FILE *src, const char alph[static 64]) {
 		switch (r) {
 		case 1: // final byte with double = padding
 			fprintf(dst, "%c", out[0]);
-			return proc;
+			return B64_DONE("bd64ss", proc);
 		case 2: // final byte with single = padding
 			fprintf(dst, "%c%c", out[0], out[1]);
-			return proc;
+			return B64_DONE("bd64ss", proc);
 		case 3: // normal case
 			fprintf(dst, "%c%c%c", out[0], out[1], out[2]);
 			break;
 		}
 	}
-	return proc;
+	return B64_DONE("bd64ss", proc);
 }
 
 // decode buffer with alphabet
 inline static size_t abd64bs(FILE *dst, const char *src, size_t n, const char alph[static 64]) {
+	B64_BEGIN();
 	size_t proc = 0;
 	size_t ptr = 0;
 	char out[3];
@@ -232,22 +287,22 @@ inline static size_t abd64bs(FILE *dst, const char *src, size_t n, const char al
 	// note that there may be extra data in the buffer
 	while ((n - ptr) / 4) {
 		r = abd64c(out, src + ptr, alph);
-		if (!r) return proc;
+		if (!r) return B64_DONE("bd64bs", proc);
 		proc += 4;
 		ptr += 4;
 		switch (r) {
 			case 1: // final byte with double = padding
 				fprintf(dst, "%c", out[0]);
-				return proc;
+				return B64_DONE("bd64bs", proc);
 			case 2: // final byte with single = padding
 				fprintf(dst, "%c%c", out[0], out[1]);
-				return proc;
+				return B64_DONE("bd64bs", proc);
 			case 3: // normal case
 				fprintf(dst, "%c%c%c", out[0], out[1], out[2]);
 				break;
 		}
 	}
-	return proc;
+	return B64_DONE("bd64bs", proc);
 }
 
 size_t bd64ss(FILE *dst, FILE *src) {
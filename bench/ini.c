@@ -0,0 +1,401 @@
+// ini.h throughput benchmark and differential check
+// usage:
+//   cc -std=c99 -D_POSIX_C_SOURCE=200809L -O2 -o bench-ini bench/ini.c
+//   ./bench-ini [MiB...]
+// For every size (default: 1 16 256), this generates a synthetic INI corpus
+// (many sections, long values, comments, CRLF, pathological whitespace,
+// and the malformed lines that error correction deals with),
+// parses it with every entry point of ini.h, and reports MB/s and events/s.
+// It also checks that all of them see the same (section, key, value) stream,
+// that documents hold that stream sorted with the last of every duplicate key,
+// and exits with 1 if they don't.
+// Sizes up to 1024 work, but you will need a few times that much memory.
+#define BREAD_INI_IMPLEMENTATION
+#include "../ini.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// = corpus
+static uint64_t rng = 0x9e3779b97f4a7c15u;
+static uint32_t rnd(uint32_t n) {
+	rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+	return rng % n;
+}
+
+struct buf {
+	char *ptr;
+	size_t len, cap;
+};
+
+static void put(struct buf *b, const char *s, size_t n) {
+	if (b->len + n > b->cap) {
+		while (b->len + n > b->cap) b->cap = b->cap ? b->cap * 2 : 1 << 20;
+		b->ptr = realloc(b->ptr, b->cap);
+		if (!b->ptr) abort();
+	}
+	memcpy(b->ptr + b->len, s, n);
+	b->len += n;
+}
+
+static void puts_(struct buf *b, const char *s) {
+	put(b, s, strlen(s));
+}
+
+static void ws(struct buf *b, int max) {
+	for (int n = rnd(max + 1); n; n--) put(b, rnd(4) ? " " : "\t", 1);
+}
+
+static void eol(struct buf *b) {
+	ws(b, rnd(8) ? 0 : 4);
+	puts_(b, rnd(3) ? "\n" : "\r\n");
+}
+
+// printable text without newlines, not starting or ending with whitespace
+static void text(struct buf *b, size_t n) {
+	char c;
+	for (size_t i = 0; i < n; i++) {
+		c = (i == 0 || i == n - 1 || rnd(6)) ? 0x21 + rnd(0x5e) : ' ';
+		put(b, &c, 1);
+	}
+}
+
+// all names stay below the default BINI_*_MAXLEN so that nothing gets truncated,
+// even when error correction turns a line into a key and the next one into its value
+static void generate(struct buf *b, size_t size) {
+	char name[64];
+	size_t section = 0, key = 0, first = 0; // first is the first key of the current section
+	while (b->len < size) {
+		switch (rnd(16)) {
+			case 0: // section, sometimes with a comment after it
+				ws(b, 2);
+				snprintf(name, sizeof(name), "[section %zu]", section++);
+				puts_(b, name);
+				if (!rnd(4)) {
+					ws(b, 2);
+					puts_(b, rnd(2) ? "# " : ";");
+					text(b, 1 + rnd(40));
+				}
+				eol(b);
+				first = key;
+				break;
+			case 1: // comment
+				ws(b, 2);
+				puts_(b, rnd(2) ? "#" : "; ");
+				text(b, 1 + rnd(80));
+				eol(b);
+				break;
+			case 2: // blank lines, possibly not quite empty
+				ws(b, 6);
+				eol(b);
+				break;
+			case 3: // things that need error correction
+				ws(b, 2);
+				switch (rnd(3)) {
+					case 0: // an unterminated section, which keeps the whitespace before the newline
+						snprintf(name, sizeof(name), "[section %zu", section++);
+						puts_(b, name);
+						first = key;
+						break;
+					case 1: // a key without =, which takes the next non-blank line as its value
+						snprintf(name, sizeof(name), "key_%zu", key++);
+						puts_(b, name);
+						break;
+					case 2: // an empty key, the rest of the line is parsed as if the = wasn't there
+						puts_(b, "=");
+						ws(b, 2);
+						text(b, 1 + rnd(16));
+						break;
+				}
+				eol(b);
+				break;
+			default: // key-value pair, sometimes with a long value
+				ws(b, rnd(4) ? 0 : 8);
+				// sometimes repeating an earlier key of the same section, where the last value wins
+				if (key > first && !rnd(16)) snprintf(name, sizeof(name), "key_%zu", first + rnd(key - first));
+				else snprintf(name, sizeof(name), "key_%zu", key++);
+				puts_(b, name);
+				// the . keeps keys unique even with a suffix
+				if (!rnd(8)) { puts_(b, "."); text(b, 1 + rnd(16)); }
+				ws(b, 3); puts_(b, "="); ws(b, 3);
+				text(b, rnd(16) ? 1 + rnd(32) : 1 + rnd(900));
+				eol(b);
+				break;
+		}
+	}
+}
+
+// = event streams
+// everything gets folded into a hash, so that comparing streams is cheap
+struct stream {
+	uint64_t hash, events;
+};
+
+static void fold(struct stream *st, const char *s, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		st->hash ^= (unsigned char)s[i];
+		st->hash *= 0x100000001b3u;
+	}
+	st->hash ^= 0xff; // separator
+	st->hash *= 0x100000001b3u;
+}
+
+static void event(struct stream *st, const char *s, size_t sn,
+		const char *k, size_t kn, const char *v, size_t vn) {
+	fold(st, s, sn); fold(st, k, kn); fold(st, v, vn);
+	st->events++;
+}
+
+static int want(const char *section, void *userdata) {
+	(void)userdata;
+	// every other section, and the pairs before the first one
+	size_t n = strlen(section);
+	return !n || (section[n - 1] - '0') % 2 == 0;
+}
+
+static int cb(const char *section, const char *key, const char *value, void *userdata) {
+	event(userdata, section, strlen(section), key, strlen(key), value, strlen(value));
+	return 0;
+}
+
+static struct stream run_cb(struct buf *corpus, int filtered) {
+	struct stream st = { 0xcbf29ce484222325u, 0 };
+	FILE *f = fmemopen(corpus->ptr, corpus->len, "r");
+	if (!f) abort();
+	if (filtered) bread_parse_ini_filter(f, &st, cb, want);
+	else bread_parse_ini(f, &st, cb);
+	fclose(f);
+	return st;
+}
+
+// chunk is how much to feed at a time, 0 for everything at once
+static struct stream run_pull(struct buf *corpus, size_t chunk, int filtered) {
+	struct stream st = { 0xcbf29ce484222325u, 0 };
+	struct bini_state state = {0};
+	struct bini_event ev;
+	char section[BINI_SEC_MAXLEN + 1] = "";
+	size_t sn = 0, fed = chunk ? 0 : corpus->len;
+
+	bini_feed(&state, corpus->ptr, fed, fed == corpus->len);
+	if (filtered && !want(section, NULL)) bini_skip(&state);
+	for (;;) {
+		switch (bini_next(&state, &ev)) {
+			case BINI_EOF:
+				return st;
+			case BINI_MORE:
+				// the corpus is contiguous, so feeding more is just moving the window
+				fed = fed + chunk < corpus->len ? fed + chunk : corpus->len;
+				bini_feed(&state, state.buf + state.pos, corpus->ptr + fed - (state.buf + state.pos),
+						fed == corpus->len);
+				break;
+			case BINI_SECTION:
+				// the span may not outlive the next feed
+				sn = ev.section.len;
+				memcpy(section, ev.section.ptr, sn);
+				section[sn] = 0;
+				if (filtered && !want(section, NULL)) bini_skip(&state);
+				break;
+			case BINI_KEYVAL:
+				event(&st, section, sn, ev.key.ptr, ev.key.len, ev.value.ptr, ev.value.len);
+				break;
+			case BINI_COMMENT:
+				break;
+		}
+	}
+}
+
+// = documents
+// a document is what's left of the stream after sorting it by section and key, keeping the last of every duplicate
+struct pair {
+	struct bini_span section, key, value;
+	size_t i; // position in the stream
+};
+
+// like strcmp, which is what documents are sorted with
+static int spancmp(struct bini_span a, struct bini_span b) {
+	int c = memcmp(a.ptr, b.ptr, a.len < b.len ? a.len : b.len);
+	return c ? c : (a.len > b.len) - (a.len < b.len);
+}
+
+static int paircmp(const void *a, const void *b) {
+	const struct pair *x = a, *y = b;
+	int c = spancmp(x->section, y->section);
+	if (!c) c = spancmp(x->key, y->key);
+	if (!c) c = (x->i > y->i) - (x->i < y->i);
+	return c;
+}
+
+static int samekey(const struct pair *x, const struct pair *y) {
+	return !spancmp(x->section, y->section) && !spancmp(x->key, y->key);
+}
+
+// what a document built from the corpus should contain, and what replaying the stream against it should give
+static void expected(struct buf *corpus, struct stream *doc, struct stream *replay) {
+	struct bini_state state = {0};
+	struct bini_event ev;
+	struct bini_span section = { "", 0 };
+	struct pair *pairs = NULL, *sorted;
+	struct bini_span *last; // the value every pair sees in the document
+	size_t n = 0, cap = 0;
+
+	bini_feed(&state, corpus->ptr, corpus->len, 1);
+	while (bini_next(&state, &ev) != BINI_EOF) {
+		if (ev.type == BINI_SECTION) section = ev.section;
+		if (ev.type != BINI_KEYVAL) continue;
+		if (n == cap) {
+			cap = cap ? cap * 2 : 1 << 16;
+			pairs = realloc(pairs, cap * sizeof(*pairs));
+			if (!pairs) abort();
+		}
+		pairs[n] = (struct pair){ section, ev.key, ev.value, n };
+		n++;
+	}
+	sorted = malloc(n * sizeof(*sorted) + 1);
+	last   = malloc(n * sizeof(*last) + 1);
+	if (!sorted || !last) abort();
+	memcpy(sorted, pairs, n * sizeof(*sorted));
+	qsort(sorted, n, sizeof(*sorted), paircmp);
+
+	*doc = (struct stream){ 0xcbf29ce484222325u, 0 };
+	for (size_t i = 0, j; i < n; i = j) {
+		for (j = i + 1; j < n && samekey(sorted + i, sorted + j); j++) {}
+		const struct pair *p = sorted + j - 1;
+		event(doc, p->section.ptr, p->section.len, p->key.ptr, p->key.len, p->value.ptr, p->value.len);
+		for (size_t k = i; k < j; k++) last[sorted[k].i] = p->value;
+	}
+	*replay = (struct stream){ 0xcbf29ce484222325u, 0 };
+	for (size_t i = 0; i < n; i++) {
+		const struct pair *p = pairs + i;
+		event(replay, p->section.ptr, p->section.len, p->key.ptr, p->key.len, last[i].ptr, last[i].len);
+	}
+	free(last);
+	free(sorted);
+	free(pairs);
+}
+
+// the document's own entries, in order
+static struct stream run_entries(struct bini_doc *doc) {
+	struct stream st = { 0xcbf29ce484222325u, 0 };
+	for (size_t i = 0; i < doc->count; i++) {
+		const char *s = doc->data + doc->entries[i].section, *k = doc->data + doc->entries[i].key,
+			*v = doc->data + doc->entries[i].value;
+		event(&st, s, strlen(s), k, strlen(k), v, strlen(v));
+	}
+	return st;
+}
+
+// replays the stream against the document, every pair should see the last value of its key
+static struct stream run_doc(struct buf *corpus, struct bini_doc *doc) {
+	struct stream st = { 0xcbf29ce484222325u, 0 };
+	struct bini_state state = {0};
+	struct bini_event ev;
+	char section[BINI_SEC_MAXLEN + 1] = "", key[BINI_KEY_MAXLEN + 1];
+	const char *value;
+
+	bini_feed(&state, corpus->ptr, corpus->len, 1);
+	for (;;) {
+		switch (bini_next(&state, &ev)) {
+			case BINI_SECTION:
+				memcpy(section, ev.section.ptr, ev.section.len);
+				section[ev.section.len] = 0;
+				continue;
+			case BINI_KEYVAL:
+				memcpy(key, ev.key.ptr, ev.key.len);
+				key[ev.key.len] = 0;
+				value = bini_doc_get(doc, section, key);
+				if (value) cb(section, key, value, &st);
+				continue;
+			default:
+				if (ev.type == BINI_EOF) return st;
+				continue;
+		}
+	}
+}
+
+// = reporting
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int failed = 0;
+
+static void report(const char *name, size_t bytes, double start, struct stream st, struct stream ref) {
+	double t = now() - start;
+	int ok = st.hash == ref.hash && st.events == ref.events;
+	printf("%-28s %10.1f MB/s %12.0f events/s %10llu events  %s\n", name,
+			bytes / t / 1e6, st.events / t, (unsigned long long)st.events, ok ? "ok" : "MISMATCH");
+	failed |= !ok;
+}
+
+static void bench(size_t mib) {
+	struct buf corpus = {0};
+	struct stream ref, fref, dref, rref, st;
+	struct bini_doc doc;
+	double start, t;
+
+	generate(&corpus, mib << 20);
+	printf("== %zu MiB corpus (%zu bytes)\n", mib, corpus.len);
+
+	start = now(); ref = run_cb(&corpus, 0);
+	report("bread_parse_ini", corpus.len, start, ref, ref);
+	start = now(); st = run_pull(&corpus, 0, 0);
+	report("bini_next", corpus.len, start, st, ref);
+	start = now(); st = run_pull(&corpus, 1 << 16, 0);
+	report("bini_next (64KiB feeds)", corpus.len, start, st, ref);
+	start = now(); st = run_pull(&corpus, 61, 0);
+	report("bini_next (61B feeds)", corpus.len, start, st, ref);
+
+	start = now(); fref = run_cb(&corpus, 1);
+	report("bread_parse_ini_filter", corpus.len, start, fref, fref);
+	start = now(); st = run_pull(&corpus, 0, 1);
+	report("bini_next + bini_skip", corpus.len, start, st, fref);
+
+	// hashing the entries isn't part of what's being timed, so the start is moved forward past it
+	expected(&corpus, &dref, &rref);
+	FILE *f = fmemopen(corpus.ptr, corpus.len, "r");
+	if (!f) abort();
+	start = now();
+	int err = bini_doc_parse(&doc, f);
+	t = now() - start;
+	fclose(f);
+	if (err) {
+		perror("bini_doc_parse");
+		failed = 1;
+	} else {
+		st = run_entries(&doc);
+		report("bini_doc_parse", corpus.len, now() - t, st, dref);
+		start = now(); st = run_doc(&corpus, &doc);
+		report("bini_doc_get (replay)", corpus.len, start, st, rref);
+	}
+
+	const char *snap = "bench-ini.snap";
+	if (!err && !bini_doc_save(&doc, snap)) {
+		bini_doc_close(&doc);
+		start = now();
+		err = bini_doc_load(&doc, snap);
+		t = now() - start;
+		if (err) {
+			perror("bini_doc_load");
+			failed = 1;
+		} else {
+			st = run_entries(&doc);
+			report("bini_doc_load", doc.size, now() - t, st, dref);
+			start = now(); st = run_doc(&corpus, &doc);
+			report("bini_doc_get (snapshot)", corpus.len, start, st, rref);
+		}
+		remove(snap);
+	}
+	bini_doc_close(&doc);
+	free(corpus.ptr);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		bench(1); bench(16); bench(256);
+	}
+	for (int i = 1; i < argc; i++) bench(strtoul(argv[i], NULL, 10));
+	return failed;
+}
@@ -2,6 +2,7 @@
 // = header
 #ifndef BREAD_INI_H
 #define BREAD_INI_H
+#include <stdint.h>
 #include <stdio.h>
 
 /* bread.h ini parser
@@ -30,6 +31,8 @@
  * Both ";" and "#" are recognized as comment characters.
  *
  * The implementation may be modified to achieve different design goals.
+ *
+ * The implementation depends on POSIX.1-2008 (ssize_t, stat, mmap, st_mtim), see the README.
  */
 
 // Returns the number of bytes, including truncated data, but not including stripped whitespace.
@@ -37,6 +40,187 @@
 int bread_parse_ini(FILE *src, void *userdata,
 		int (*cb)(const char *section, const char *key, const char *value, void *userdata));
 
+// Like bread_parse_ini, but only for the sections you want.
+// want is called once per section header, and once with "" for the pairs before the first header.
+// If it returns zero, the section is skipped by looking for the next line starting with "[",
+// without tokenizing anything in between.
+// Note that this means a value that is continued onto a line starting with "[" will end the skip.
+int bread_parse_ini_filter(FILE *src, void *userdata,
+		int (*cb)(const char *section, const char *key, const char *value, void *userdata),
+		int (*want)(const char *section, void *userdata));
+
+/* Pull-style parsing
+ * bini_next is an alternative to bread_parse_ini that works on an in-memory buffer.
+ * Rather than calling you back, it hands out one event at a time, so you can stop at any point
+ * and pick up later, or interleave parsing with other work.
+ * The grammar and error correction are the same as bread_parse_ini's, but nothing is copied:
+ * events are spans pointing into your buffer, so there are no length limits and no truncation.
+ * Spans are not NUL-terminated, and do not remember which section they came from:
+ * keep track of the latest BINI_SECTION yourself if you need it.
+ *
+ * Start with a zeroed state, call bini_feed with the data you have, then call bini_next until it returns BINI_EOF.
+ * If last is 0, more data may follow, and bini_next returns BINI_MORE rather than an incomplete event.
+ * At that point, the bytes from state.pos onwards have not been consumed yet:
+ * call bini_feed again with a buffer that starts with them, followed by the new data.
+ * Spans handed out before that are only valid for as long as you keep the old buffer around.
+ *
+ * To ignore a section, call bini_skip after receiving its BINI_SECTION event
+ * (or before the first bini_next, for the pairs before the first header).
+ * The next bini_next will then jump to the following line starting with "[" without tokenizing anything,
+ * even across calls to bini_feed.
+ *
+ * Like everything else here, bini_next is an ordinary function in the implementation,
+ * so it can only be inlined into loops in the translation unit that defines BREAD_INI_IMPLEMENTATION
+ * (or anywhere, with LTO).
+ */
+enum bini_type {
+	BINI_EOF,     // no more events
+	BINI_MORE,    // feed more data to continue
+	BINI_SECTION, // section is set
+	BINI_KEYVAL,  // key and value are set
+	BINI_COMMENT, // value is set to the comment, without the comment character
+};
+
+struct bini_span {
+	const char *ptr;
+	size_t len;
+};
+
+struct bini_event {
+	enum bini_type type;
+	struct bini_span section, key, value;
+};
+
+struct bini_state {
+	const char *buf;
+	size_t len, pos;
+	int last, skip;
+};
+
+void bini_feed(struct bini_state *state, const char *buf, size_t len, int last);
+enum bini_type bini_next(struct bini_state *state, struct bini_event *event);
+void bini_skip(struct bini_state *state);
+
+/* Documents and snapshots
+ * struct bini_doc holds a whole parsed file, sorted by section and then key, for lookups with bini_doc_get.
+ * Pairs before the first section header are in section "".
+ * If a key appears more than once in a section, the last value wins.
+ *
+ * A document is laid out in memory exactly like its snapshot on disk:
+ * a header, a table of NUL-terminated strings, and the sorted entries, which are offsets into data.
+ * Saving one is a single fwrite, and loading one is a single mmap, with no parsing involved.
+ * You may iterate over entries[0..count) directly, e.g. `data + entries[i].key`.
+ * Since offsets are 32 bits, a document cannot be larger than 4GiB.
+ *
+ * bini_doc_open is what you usually want: it loads the snapshot at snap if it is still valid for the file at path,
+ * and otherwise parses path and (tries to) write a new snapshot for next time.
+ * Documents are parsed by reading the whole source into memory and going through it with bini_next,
+ * so unlike with bread_parse_ini, nothing is ever truncated.
+ * A snapshot is valid if the source has the same size and mtime as when it was taken,
+ * or failing that, the same size and contents (so that touching the source doesn't force a reparse).
+ * The mtime is only trusted if it is older than the snapshot itself:
+ * otherwise, the source could have been changed again within the same timestamp tick, so it is hashed.
+ * Snapshots use the native byte order: they are a local cache, not an interchange format.
+ *
+ * All functions returning int return 0 on success and -1 on error, with errno set.
+ * Always bini_doc_close a document once you're done, even if opening it failed.
+ */
+struct bini_entry {
+	uint32_t section, key, value;
+};
+
+struct bini_doc {
+	char *data;
+	size_t size;
+	struct bini_entry *entries;
+	size_t count;
+	int mapped;
+	// only used while parsing
+	size_t cap, ecap;
+	// converted values for bini_doc_ref, see below
+	struct bini_value *cache;
+};
+
+int bini_doc_open(struct bini_doc *doc, const char *path, const char *snap);
+int bini_doc_parse(struct bini_doc *doc, FILE *src);
+int bini_doc_load(struct bini_doc *doc, const char *snap);
+int bini_doc_save(const struct bini_doc *doc, const char *snap);
+void bini_doc_close(struct bini_doc *doc);
+// returns NULL if there is no such key
+const char *bini_doc_get(const struct bini_doc *doc, const char *section, const char *key);
+
+/* Typed values
+ * These convert a value (e.g. a span from bini_next, or a string from a callback) without going
+ * through strtol and friends. They don't look at the locale, and the whole value must be valid:
+ * "12 apples" is not an integer.
+ * They return 0 on success, and -1 on failure with errno set (usually to EINVAL or ERANGE), leaving out untouched.
+ *
+ * * bini_int and bini_uint accept decimal, or hexadecimal with a 0x prefix
+ * * bini_double accepts decimal with an optional fraction and exponent
+ *   (values that can't be converted exactly the fast way fall back to strtod, without a decimal point)
+ * * bini_bool accepts 1/0, true/false, yes/no and on/off, ignoring case
+ * * bini_duration accepts an integer followed by ns, us, ms, s, m, h or d, and returns nanoseconds
+ *   (an integer without a unit is in seconds)
+ * * bini_size accepts an integer followed by B, K, M, G, T, P or E, and returns bytes
+ *   (K and KiB are 1024, KB is 1000, and so on, ignoring case)
+ * Whitespace is allowed between the number and the unit.
+ *
+ * The bini_doc_* variants look the value up in a document first, failing with ENOENT if it isn't there.
+ * They only read the document, so they may be called from any number of threads at once.
+ *
+ * For settings that are read over and over, bini_doc_ref does the lookup and conversion once,
+ * and returns a handle to the result that stays valid until bini_doc_close, so that every read is a single load:
+ *   const struct bini_value *port = bini_doc_ref(&doc, "server", "port", BINI_KIND_UINT);
+ *   if (!port) ...; // errno is set like above
+ *   connect_to(port->v.u);
+ * v.i is set for BINI_KIND_INT and BINI_KIND_DURATION, v.u for BINI_KIND_UINT and BINI_KIND_SIZE,
+ * v.d for BINI_KIND_DOUBLE and v.b for BINI_KIND_BOOL.
+ * The results live in a cache with a slot per entry, which the first bini_doc_ref on a document allocates.
+ * Each entry can only be converted to one kind, asking for another one fails with EEXIST.
+ * bini_doc_ref writes to the document, so don't call it from several threads at once
+ * (resolve your handles up front instead); reading through handles is fine.
+ */
+int bini_int(const char *s, size_t n, int64_t *out);
+int bini_uint(const char *s, size_t n, uint64_t *out);
+int bini_double(const char *s, size_t n, double *out);
+int bini_bool(const char *s, size_t n, int *out);
+int bini_duration(const char *s, size_t n, int64_t *out);
+int bini_size(const char *s, size_t n, uint64_t *out);
+
+int bini_doc_int(const struct bini_doc *doc, const char *section, const char *key, int64_t *out);
+int bini_doc_uint(const struct bini_doc *doc, const char *section, const char *key, uint64_t *out);
+int bini_doc_double(const struct bini_doc *doc, const char *section, const char *key, double *out);
+int bini_doc_bool(const struct bini_doc *doc, const char *section, const char *key, int *out);
+int bini_doc_duration(const struct bini_doc *doc, const char *section, const char *key, int64_t *out);
+int bini_doc_size(const struct bini_doc *doc, const char *section, const char *key, uint64_t *out);
+
+enum bini_kind { BINI_KIND_NONE, BINI_KIND_INT, BINI_KIND_UINT, BINI_KIND_DOUBLE, BINI_KIND_BOOL, BINI_KIND_DURATION, BINI_KIND_SIZE };
+
+struct bini_value {
+	enum bini_kind kind;
+	union {
+		int64_t i;
+		uint64_t u;
+		double d;
+		int b;
+	} v;
+};
+
+const struct bini_value *bini_doc_ref(struct bini_doc *doc, const char *section, const char *key, enum bini_kind kind);
+
+#ifdef BREAD_STATS
+// Counters for every bread_parse_ini(_filter) call in the program, see the README.
+struct bini_stats {
+	unsigned long long calls;       // calls to bread_parse_ini(_filter)
+	unsigned long long bytes;       // bytes parsed, as returned by them
+	unsigned long long callbacks;   // calls to cb
+	unsigned long long truncations; // strings that didn't fit into their working buffer
+	unsigned long long skips;       // sections skipped by bread_parse_ini_filter
+	unsigned long long ns;          // time spent in them
+};
+void bini_stats(struct bini_stats *out);
+#endif
+
 #endif // BREAD_INI_H
 
 #ifdef BREAD_INI_IMPLEMENTATION
@@ -52,11 +236,41 @@ int bread_parse_ini(FILE *src, void *userdata,
 #define BINI_VAL_MAXLEN BINI_KEY_MAXLEN * 16
 #endif
 
+#include <errno.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 typedef int (*callback)(const char*, const char*, const char*, void*);
 
+// == statistics and tracing
+#ifndef BREAD_TRACE
+#define BREAD_TRACE(name, n) ((void)0)
+#endif
+
+#ifdef BREAD_STATS
+#include <time.h>
+static struct bini_stats bini_counters;
+#define BINI_STAT(field, n) (bini_counters.field += (n))
+
+static unsigned long long bini_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void bini_stats(struct bini_stats *out) {
+	*out = bini_counters;
+}
+#else
+#define BINI_STAT(field, n) ((void)0)
+#endif
+
 // == general utilities
 // scan c from the right until not in s, set final ptr to 0
 // returns new strlen
@@ -76,6 +290,10 @@ static inline int stripright(char *c, const char *s) {
 // == character classes
 const static char wss[] = " \t\r\n";
 
+static inline bool bini_isws(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
 // == parsing utilities
 // skip as long as the condition holds
 // does not consume the character after
@@ -108,6 +326,27 @@ static int parse_skipuntil(FILE *src, const char *s) {
 
 #define parse_skipws(src) parse_skipwhile(src, wss)
 
+// skip until the next line whose first non-whitespace character is a [
+// does not consume the [
+// this is on the hot path when filtering, so it avoids strchr
+static int parse_skipsection(FILE *src) {
+	int c, out = 0;
+	for (;;) {
+		while ((c = fgetc(src)) != EOF && bini_isws(c)) out++;
+		if (c == '[') {
+			ungetc(c, src);
+			return out;
+		}
+		if (c == EOF) break;
+		out++;
+		while ((c = fgetc(src)) != EOF && c != '\n') out++;
+		if (c == EOF) break;
+		out++;
+	}
+	// hit error
+	return ferror(src) ? -out : out;
+}
+
 // parses into ptr as long as getc is in s and maxlen holds
 // if maxlen is exhausted, continue by skipping
 // does not consume the character that follows
@@ -130,6 +369,8 @@ static int parse_while(FILE *src, char *ptr, ssize_t maxlen, const char *s) {
 	}
 	// we hit maxlen
 	(*--ptr) = 0;
+	BINI_STAT(truncations, 1);
+	BREAD_TRACE("bini_truncate", out);
 	int skipped = parse_skipwhile(src, s);
 	if (skipped > 0) {
 		return out + skipped;
@@ -156,6 +397,8 @@ static int parse_until(FILE *src, char *ptr, ssize_t maxlen, const char *s) {
 	}
 	// we hit maxlen
 	(*--ptr) = 0;
+	BINI_STAT(truncations, 1);
+	BREAD_TRACE("bini_truncate", out);
 	int skipped = parse_skipuntil(src, s);
 	if (skipped > 0) {
 		return out + skipped;
@@ -196,22 +439,27 @@ static int parse_kv(FILE *src, void *userdata,
 	tmp = parse_value(src, value);
 	len += tmp > 0 ? tmp : -tmp; // errors are fine as long as we finished parsing
 
+	BINI_STAT(callbacks, 1);
 	if (cb(section, key, value, userdata)) len *= -1; // cb requested error
 	return len;
 }
 
 static int parse_expr(FILE *src, void *userdata,
-		char *section, char *key, char *value, callback cb) {
+		char *section, char *key, char *value, callback cb, int (*want)(const char *, void *)) {
 	int len = parse_skipws(src);
 	if (len) return len;
 
-	int c;
+	int c, tmp;
 	switch ((c = fgetc(src))) {
 		case EOF:
 			return 0;
 		case '[':
 			// section, we want to skip over the [
-			return parse_section(src, section);
+			len = parse_section(src, section);
+			if (len < 0 || !want || want(section, userdata)) return len;
+			tmp = parse_skipsection(src);
+			BINI_STAT(skips, 1);
+			return tmp < 0 ? tmp - len : tmp + len;
 		case '#':
 		case ';':
 			// comment, we don't care about the comment character
@@ -224,7 +472,10 @@ static int parse_expr(FILE *src, void *userdata,
 	return 0;
 }
 
-int bread_parse_ini(FILE *src, void *userdata, callback cb) {
+int bread_parse_ini_filter(FILE *src, void *userdata, callback cb, int (*want)(const char *, void *)) {
+#ifdef BREAD_STATS
+	unsigned long long start = bini_now();
+#endif
 #if defined(BINI_MALLOC)
 	char *section = BINI_MALLOC(BINI_SEC_MAXLEN);
 	char *key     = BINI_MALLOC(BINI_KEY_MAXLEN);
@@ -237,8 +488,14 @@ int bread_parse_ini(FILE *src, void *userdata, callback cb) {
 #endif
 
 	int status, out = 0;
+	// the pairs before the first section
+	if (want && !want(section, userdata)) {
+		status = parse_skipsection(src);
+		out += status < 0 ? -status : status;
+		BINI_STAT(skips, 1);
+	}
 	// as long as we're consuming output...
-	while ((status = parse_expr(src, userdata, section, key, value, cb)) >= 0) {
+	while ((status = parse_expr(src, userdata, section, key, value, cb, want)) >= 0) {
 		out += status;
 		if (feof(src) || ferror(src)) break;
 	}
@@ -248,6 +505,716 @@ int bread_parse_ini(FILE *src, void *userdata, callback cb) {
 	BINI_FREE(key);
 	BINI_FREE(value);
 #endif
+	BINI_STAT(calls, 1);
+	BINI_STAT(bytes, out);
+#ifdef BREAD_STATS
+	BINI_STAT(ns, bini_now() - start);
+#endif
+	BREAD_TRACE("bread_parse_ini", out);
 	return ferror(src) ? -out : out;
 }
+
+int bread_parse_ini(FILE *src, void *userdata, callback cb) {
+	return bread_parse_ini_filter(src, userdata, cb, NULL);
+}
+
+// == pull parser
+// first occurrence of a or b in [p, end), or end
+static inline const char *bini_scanuntil(const char *p, const char *end, char a, char b) {
+	while (p < end && *p != a && *p != b) p++;
+	return p;
+}
+
+// span of [p, end) without trailing whitespace
+static inline struct bini_span bini_stripspan(const char *p, const char *end) {
+	while (end > p && bini_isws(end[-1])) end--;
+	return (struct bini_span){ p, end - p };
+}
+
+void bini_feed(struct bini_state *state, const char *buf, size_t len, int last) {
+	state->buf  = buf;
+	state->len  = len;
+	state->pos  = 0;
+	state->last = last;
+}
+
+void bini_skip(struct bini_state *state) {
+	state->skip = 1;
+}
+
+// every branch mirrors the corresponding parse_* function above
+// whenever we would hit EOF without being the last buffer, we ask for more instead
+enum bini_type bini_next(struct bini_state *state, struct bini_event *event) {
+	const char *p = state->buf + state->pos, *end = state->buf + state->len, *q, *v;
+	// skip whole lines until one starts with a [
+	while (state->skip) {
+		while (p < end && bini_isws(*p)) p++;
+		state->pos = p - state->buf;
+		if (p == end) return event->type = state->last ? BINI_EOF : BINI_MORE;
+		if (*p == '[') {
+			state->skip = 0;
+			break;
+		}
+		q = memchr(p, '\n', end - p);
+		if (!q) {
+			if (!state->last) return event->type = BINI_MORE;
+			state->pos = state->len;
+			return event->type = BINI_EOF;
+		}
+		p = q + 1;
+	}
+	for (;;) {
+		while (p < end && bini_isws(*p)) p++;
+		state->pos = p - state->buf;
+		if (p == end) return event->type = state->last ? BINI_EOF : BINI_MORE;
+
+		switch (*p) {
+			case '[':
+				q = bini_scanuntil(p + 1, end, ']', '\n');
+				if (q == end && !state->last) return event->type = BINI_MORE;
+				// unlike keys and values, sections keep their whitespace
+				event->section = (struct bini_span){ p + 1, q - (p + 1) };
+				state->pos = (q == end ? q : q + 1) - state->buf;
+				return event->type = BINI_SECTION;
+			case '#':
+			case ';':
+				q = bini_scanuntil(p + 1, end, '\n', '\n');
+				if (q == end && !state->last) return event->type = BINI_MORE;
+				event->value = bini_stripspan(p + 1, q);
+				state->pos = (q == end ? q : q + 1) - state->buf;
+				return event->type = BINI_COMMENT;
+		}
+
+		// a key-value pair
+		q = bini_scanuntil(p, end, '=', '\n');
+		if (q == end) break;
+		event->key = bini_stripspan(p, q);
+		if (!event->key.len) { // empty key, skip the = and try again
+			p = q + 1;
+			continue;
+		}
+		for (v = q + 1; v < end && bini_isws(*v); v++) {}
+		if (v == end) break;
+		q = bini_scanuntil(v, end, '\n', '\n');
+		if (q == end && !state->last) break;
+		event->value = bini_stripspan(v, q);
+		state->pos = (q == end ? q : q + 1) - state->buf;
+		return event->type = BINI_KEYVAL;
+	}
+	// an incomplete key-value pair
+	if (!state->last) return event->type = BINI_MORE;
+	state->pos = state->len;
+	return event->type = BINI_EOF;
+}
+
+// == documents
+// the start of every document, and of the snapshot file
+struct bini_snap {
+	char magic[4];
+	uint32_t version;
+	uint64_t count, entries; // entries is the offset of the first entry
+	uint64_t size, mtime, hash; // describe the source, 0 if unknown
+};
+
+static const char bini_snap_magic[4] = "BINI";
+#define BINI_SNAP_VERSION 1
+
+// FNV-1a, which is plenty for telling whether a file changed
+static uint64_t bini_doc_hash(const char *buf, size_t n) {
+	uint64_t h = 0xcbf29ce484222325u;
+	for (size_t i = 0; i < n; i++) {
+		h ^= (unsigned char)buf[i];
+		h *= 0x100000001b3u;
+	}
+	return h;
+}
+
+// read all of src into a malloc'd buffer, growing it geometrically
+static char *bini_doc_slurp(FILE *src, size_t *len) {
+	size_t cap = 65536, n = 0;
+	char *buf = malloc(cap), *tmp;
+	if (!buf) return NULL;
+	for (;;) {
+		n += fread(buf + n, 1, cap - n, src);
+		if (n < cap) break;
+		if (!(tmp = realloc(buf, cap *= 2))) {
+			free(buf);
+			return NULL;
+		}
+		buf = tmp;
+	}
+	if (ferror(src)) {
+		free(buf);
+		errno = EIO;
+		return NULL;
+	}
+	*len = n;
+	return buf;
+}
+
+static uint64_t bini_doc_mtime(const struct stat *st) {
+	return (uint64_t)st->st_mtim.tv_sec * 1000000000u + st->st_mtim.tv_nsec;
+}
+
+// make room for n more bytes in data, growing geometrically
+static int bini_doc_reserve(struct bini_doc *doc, size_t n) {
+	if (doc->size + n <= doc->cap) return 0;
+	size_t cap = doc->cap ? doc->cap : 4096;
+	while (cap < doc->size + n) cap *= 2;
+	char *data = realloc(doc->data, cap);
+	if (!data) return -1;
+	doc->data = data;
+	doc->cap  = cap;
+	return 0;
+}
+
+// append a span to the string table as a NUL-terminated string, returns its offset or 0 on error
+static uint32_t bini_doc_str(struct bini_doc *doc, struct bini_span s) {
+	size_t at = doc->size;
+	if (at + s.len + 1 > UINT32_MAX) {
+		errno = EFBIG;
+		return 0;
+	}
+	if (bini_doc_reserve(doc, s.len + 1)) return 0;
+	memcpy(doc->data + at, s.ptr, s.len);
+	doc->data[at + s.len] = 0;
+	doc->size += s.len + 1;
+	return at;
+}
+
+static int bini_doc_add(struct bini_doc *doc, uint32_t section, struct bini_span key, struct bini_span value) {
+	struct bini_entry e = { section, 0, 0 };
+	if (!(e.key   = bini_doc_str(doc, key)))   return -1;
+	if (!(e.value = bini_doc_str(doc, value))) return -1;
+
+	if (doc->count == doc->ecap) {
+		size_t ecap = doc->ecap ? doc->ecap * 2 : 64;
+		struct bini_entry *entries = realloc(doc->entries, ecap * sizeof(*entries));
+		if (!entries) return -1;
+		doc->entries = entries;
+		doc->ecap    = ecap;
+	}
+	doc->entries[doc->count++] = e;
+	return 0;
+}
+
+struct bini_doc_sort {
+	const char *section, *key;
+	struct bini_entry e;
+};
+
+static int bini_doc_cmp(const void *a, const void *b) {
+	const struct bini_doc_sort *x = a, *y = b;
+	int c = strcmp(x->section, y->section);
+	if (!c) c = strcmp(x->key, y->key);
+	// values are appended in order, so this keeps duplicates in the order they were parsed
+	if (!c) c = (x->e.value > y->e.value) - (x->e.value < y->e.value);
+	return c;
+}
+
+// sort the entries and append them to data, turning it into a snapshot
+static int bini_doc_finish(struct bini_doc *doc) {
+	size_t at = (doc->size + 7) & ~(size_t)7, n = 0;
+	if (bini_doc_reserve(doc, at - doc->size + doc->count * sizeof(struct bini_entry))) return -1;
+	memset(doc->data + doc->size, 0, at - doc->size);
+
+	// data won't move anymore, so we can sort on pointers into it
+	struct bini_doc_sort *tmp = malloc(doc->count * sizeof(*tmp) + 1);
+	if (!tmp) return -1;
+	for (size_t i = 0; i < doc->count; i++) {
+		tmp[i].section = doc->data + doc->entries[i].section;
+		tmp[i].key     = doc->data + doc->entries[i].key;
+		tmp[i].e       = doc->entries[i];
+	}
+	qsort(tmp, doc->count, sizeof(*tmp), bini_doc_cmp);
+
+	// keep only the last of every run of identical keys
+	struct bini_entry *out = (struct bini_entry *)(doc->data + at);
+	for (size_t i = 0; i < doc->count; i++) {
+		if (i + 1 < doc->count && !strcmp(tmp[i].section, tmp[i + 1].section)
+				&& !strcmp(tmp[i].key, tmp[i + 1].key)) continue;
+		out[n++] = tmp[i].e;
+	}
+	free(tmp);
+	free(doc->entries);
+	doc->entries = out;
+	doc->count   = n;
+	doc->ecap    = 0;
+	doc->size    = at + n * sizeof(*out);
+
+	struct bini_snap *hdr = (struct bini_snap *)doc->data;
+	memcpy(hdr->magic, bini_snap_magic, sizeof(bini_snap_magic));
+	hdr->version = BINI_SNAP_VERSION;
+	hdr->count   = n;
+	hdr->entries = at;
+	return 0;
+}
+
+// parse a whole buffer into a fresh document
+static int bini_doc_build(struct bini_doc *doc, const char *buf, size_t len) {
+	struct bini_state state = {0};
+	struct bini_event ev;
+	struct bini_span section = { "", 0 };
+	uint32_t secoff = 0; // where section is in the string table, 0 if it isn't there yet
+
+	memset(doc, 0, sizeof(*doc));
+	if (bini_doc_reserve(doc, sizeof(struct bini_snap))) return -1;
+	memset(doc->data, 0, sizeof(struct bini_snap));
+	doc->size = sizeof(struct bini_snap);
+
+	bini_feed(&state, buf, len, 1);
+	while (bini_next(&state, &ev) != BINI_EOF) {
+		switch (ev.type) {
+			case BINI_SECTION:
+				section = ev.section;
+				secoff  = 0;
+				break;
+			case BINI_KEYVAL:
+				// the section is the same for many pairs in a row, only store it once
+				if (!secoff && !(secoff = bini_doc_str(doc, section))) return -1;
+				if (bini_doc_add(doc, secoff, ev.key, ev.value)) return -1;
+				break;
+			default:
+				break;
+		}
+	}
+	return bini_doc_finish(doc);
+}
+
+int bini_doc_parse(struct bini_doc *doc, FILE *src) {
+	size_t len;
+	char *buf = bini_doc_slurp(src, &len);
+	if (!buf) {
+		memset(doc, 0, sizeof(*doc));
+		return -1;
+	}
+	int err = bini_doc_build(doc, buf, len);
+	free(buf);
+	return err;
+}
+
+// check everything we'll dereference later, so a corrupt snapshot can't crash us
+static int bini_doc_valid(const struct bini_doc *doc) {
+	const struct bini_snap *hdr = (const struct bini_snap *)doc->data;
+	if (doc->size < sizeof(*hdr)) return 0;
+	if (memcmp(hdr->magic, bini_snap_magic, sizeof(bini_snap_magic)) || hdr->version != BINI_SNAP_VERSION) return 0;
+	if (hdr->entries < sizeof(*hdr) || hdr->entries % 8 || hdr->entries > doc->size) return 0;
+	if (hdr->count != (doc->size - hdr->entries) / sizeof(struct bini_entry)) return 0;
+	// the string table must end in a NUL for every string in it to be terminated
+	size_t end = hdr->entries;
+	if (end > sizeof(*hdr) && doc->data[end - 1]) return 0;
+	const struct bini_entry *e = (const struct bini_entry *)(doc->data + end);
+	for (size_t i = 0; i < hdr->count; i++) {
+		if (e[i].section < sizeof(*hdr) || e[i].section >= end) return 0;
+		if (e[i].key     < sizeof(*hdr) || e[i].key     >= end) return 0;
+		if (e[i].value   < sizeof(*hdr) || e[i].value   >= end) return 0;
+	}
+	return 1;
+}
+
+// written is set to the snapshot's mtime, which is when it was written
+static int bini_doc_map(struct bini_doc *doc, const char *snap, uint64_t *written) {
+	struct stat st;
+	memset(doc, 0, sizeof(*doc));
+	int fd = open(snap, O_RDONLY);
+	if (fd < 0) return -1;
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(struct bini_snap)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return -1;
+	doc->data   = data;
+	doc->size   = st.st_size;
+	doc->mapped = 1;
+	*written    = bini_doc_mtime(&st);
+	if (!bini_doc_valid(doc)) {
+		errno = EINVAL;
+		return -1;
+	}
+	const struct bini_snap *hdr = data;
+	doc->entries = (struct bini_entry *)(doc->data + hdr->entries);
+	doc->count   = hdr->count;
+	return 0;
+}
+
+int bini_doc_load(struct bini_doc *doc, const char *snap) {
+	uint64_t written;
+	return bini_doc_map(doc, snap, &written);
+}
+
+// written to a temporary file of its own first, which is then renamed over snap,
+// so that concurrent readers never see half a snapshot, and concurrent writers don't clobber each other's
+// hdr replaces the document's own header, so that a mapped document can be saved with changes to it
+static int bini_doc_write(const struct bini_doc *doc, const struct bini_snap *hdr, const char *snap) {
+	size_t len = strlen(snap);
+	char *tmp = malloc(len + sizeof(".XXXXXX"));
+	if (!tmp) return -1;
+	memcpy(tmp, snap, len);
+	memcpy(tmp + len, ".XXXXXX", sizeof(".XXXXXX"));
+
+	int fd = mkstemp(tmp);
+	if (fd < 0) {
+		free(tmp);
+		return -1;
+	}
+	FILE *f = fdopen(fd, "wb");
+	int err = !f;
+	if (f) {
+		err |= fwrite(hdr, 1, sizeof(*hdr), f) != sizeof(*hdr);
+		err |= fwrite(doc->data + sizeof(*hdr), 1, doc->size - sizeof(*hdr), f) != doc->size - sizeof(*hdr);
+		err |= fclose(f) != 0;
+	} else {
+		close(fd);
+	}
+	if (!err) err = rename(tmp, snap) != 0;
+	if (err) remove(tmp);
+	free(tmp);
+	return err ? -1 : 0;
+}
+
+int bini_doc_save(const struct bini_doc *doc, const char *snap) {
+	return bini_doc_write(doc, (const struct bini_snap *)doc->data, snap);
+}
+
+int bini_doc_open(struct bini_doc *doc, const char *path, const char *snap) {
+	struct stat st;
+	if (stat(path, &st)) {
+		memset(doc, 0, sizeof(*doc));
+		return -1;
+	}
+	uint64_t mtime = bini_doc_mtime(&st), written;
+	int loaded = !bini_doc_map(doc, snap, &written);
+	const struct bini_snap *hdr = (const struct bini_snap *)doc->data;
+	// with coarse timestamps, the source may have been rewritten in the same tick as the snapshot,
+	// so its mtime only proves anything if it is older than the snapshot (just like git's racily clean entries)
+	if (loaded && hdr->size == (uint64_t)st.st_size && hdr->mtime == mtime && mtime < written) return 0;
+
+	// the source is only read once, for both hashing and parsing
+	FILE *src = fopen(path, "rb");
+	if (!src) return -1;
+	size_t len;
+	char *buf = bini_doc_slurp(src, &len);
+	fclose(src);
+	if (!buf) return -1;
+	uint64_t hash = bini_doc_hash(buf, len);
+	if (loaded && hdr->size == len && hdr->hash == hash) {
+		// only touched, remember the new mtime so that next time we don't have to hash again
+		struct bini_snap fresh = *hdr;
+		fresh.mtime = mtime;
+		bini_doc_write(doc, &fresh, snap);
+		free(buf);
+		return 0;
+	}
+
+	// stale, reparse
+	bini_doc_close(doc);
+	int err = bini_doc_build(doc, buf, len);
+	free(buf);
+	if (err) return err;
+	struct bini_snap *out = (struct bini_snap *)doc->data;
+	out->size  = len;
+	out->mtime = mtime;
+	out->hash  = hash;
+	bini_doc_save(doc, snap); // it's only a cache, so failing to write it is fine
+	return 0;
+}
+
+void bini_doc_close(struct bini_doc *doc) {
+	if (doc->ecap) free(doc->entries);
+	free(doc->cache);
+	if (doc->mapped) munmap(doc->data, doc->size);
+	else free(doc->data);
+	memset(doc, 0, sizeof(*doc));
+}
+
+static const struct bini_entry *bini_doc_find(const struct bini_doc *doc, const char *section, const char *key) {
+	size_t lo = 0, hi = doc->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const struct bini_entry *e = doc->entries + mid;
+		int c = strcmp(section, doc->data + e->section);
+		if (!c) c = strcmp(key, doc->data + e->key);
+		if (!c) return e;
+		if (c < 0) hi = mid;
+		else lo = mid + 1;
+	}
+	return NULL;
+}
+
+const char *bini_doc_get(const struct bini_doc *doc, const char *section, const char *key) {
+	const struct bini_entry *e = bini_doc_find(doc, section, key);
+	return e ? doc->data + e->value : NULL;
+}
+
+// == typed values
+static inline bool bini_isdigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// ASCII-only case-insensitive comparison of [s, s+n) against a lowercase literal
+static bool bini_eqi(const char *s, size_t n, const char *lit) {
+	for (; n; n--, s++, lit++) {
+		char c = *s >= 'A' && *s <= 'Z' ? *s - 'A' + 'a' : *s;
+		if (!*lit || c != *lit) return false;
+	}
+	return !*lit;
+}
+
+static int bini_fail(int err) {
+	errno = err;
+	return -1;
+}
+
+// parse an unsigned integer at *p, advancing it
+static int bini_scan_uint(const char **p, const char *end, uint64_t *out, bool hex) {
+	const char *s = *p;
+	uint64_t v = 0, base = hex ? 16 : 10;
+	for (; s < end; s++) {
+		unsigned d;
+		if (bini_isdigit(*s)) d = *s - '0';
+		else if (hex && *s >= 'a' && *s <= 'f') d = *s - 'a' + 10;
+		else if (hex && *s >= 'A' && *s <= 'F') d = *s - 'A' + 10;
+		else break;
+		if (v > (UINT64_MAX - d) / base) return bini_fail(ERANGE);
+		v = v * base + d;
+	}
+	if (s == *p) return bini_fail(EINVAL);
+	*p = s; *out = v;
+	return 0;
+}
+
+// an unsigned integer making up the rest of [*p, end), in decimal or hex
+// *out is only written on success
+static int bini_scan_whole(const char *p, const char *end, uint64_t *out) {
+	bool hex = end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X');
+	uint64_t v;
+	if (hex) p += 2;
+	if (bini_scan_uint(&p, end, &v, hex)) return -1;
+	if (p != end) return bini_fail(EINVAL);
+	*out = v;
+	return 0;
+}
+
+int bini_uint(const char *s, size_t n, uint64_t *out) {
+	const char *end = s + n;
+	uint64_t v;
+	if (s < end && *s == '+') s++;
+	if (bini_scan_whole(s, end, &v)) return -1;
+	*out = v;
+	return 0;
+}
+
+int bini_int(const char *s, size_t n, int64_t *out) {
+	const char *end = s + n;
+	bool neg = s < end && *s == '-';
+	if (s < end && (*s == '-' || *s == '+')) s++;
+	uint64_t v;
+	if (bini_scan_whole(s, end, &v)) return -1;
+	if (v > (uint64_t)INT64_MAX + neg) return bini_fail(ERANGE);
+	*out = neg ? (int64_t)(0 - v) : (int64_t)v;
+	return 0;
+}
+
+int bini_double(const char *s, size_t n, double *out) {
+	// exactly representable powers of ten
+	static const double pow10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+	const char *p = s, *end = s + n;
+	bool neg = p < end && *p == '-', exact = true, any = false;
+	if (p < end && (*p == '-' || *p == '+')) p++;
+
+	// accumulate up to 19 significant digits into m, so that value = m * 10^exp
+	uint64_t m = 0;
+	int digits = 0, exp = 0;
+	size_t frac = 0; // digits after the decimal point
+	for (; p < end && bini_isdigit(*p); p++, any = true) {
+		if (digits < 19) {
+			m = m * 10 + (*p - '0');
+			digits += m != 0;
+		} else {
+			exp++;
+			exact &= *p == '0';
+		}
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && bini_isdigit(*p); p++, frac++, any = true) {
+			if (digits < 19) {
+				m = m * 10 + (*p - '0');
+				digits += m != 0;
+				exp--;
+			} else {
+				exact &= *p == '0';
+			}
+		}
+	}
+	if (!any) return bini_fail(EINVAL);
+	int e10 = 0; // the exponent as written
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool eneg = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+')) p++;
+		uint64_t e;
+		if (p == end || !bini_isdigit(*p)) return bini_fail(EINVAL);
+		if (bini_scan_uint(&p, end, &e, false)) {
+			// way out of range either way, let strtod decide between 0 and infinity
+			while (p < end && bini_isdigit(*p)) p++;
+			e = 100000;
+		}
+		if (e > 100000) e = 100000;
+		e10 = eneg ? -(int)e : (int)e;
+		exp += e10;
+	}
+	if (p != end) return bini_fail(EINVAL);
+
+	// when both m and 10^exp are exact doubles, a single multiplication or division rounds correctly
+	if (exact && m <= (UINT64_C(1) << 53) && exp >= -22 && exp <= 22) {
+		double d = exp < 0 ? (double)m / pow10[-exp] : (double)m * pow10[exp];
+		*out = neg ? -d : d;
+		return 0;
+	}
+
+	// otherwise, leave the rounding to strtod
+	// the decimal point is the only part of this syntax that depends on the locale,
+	// so hand it the digits without one, and the exponent adjusted to match: 1.25e3 becomes 125e1
+	char small[128], *buf = small, *q, *tail;
+	size_t cap = n + 32;
+	if (cap > sizeof(small) && !(buf = malloc(cap))) return -1;
+	q = buf;
+	if (neg) *q++ = '-';
+	for (p = s; p < end && *p != 'e' && *p != 'E'; p++) {
+		if (bini_isdigit(*p)) *q++ = *p;
+	}
+	q += snprintf(q, buf + cap - q, "e%lld", (long long)e10 - (long long)frac);
+	errno = 0;
+	double d = strtod(buf, &tail);
+	int err = tail != q ? EINVAL : errno;
+	if (buf != small) free(buf);
+	if (err) return bini_fail(err);
+	*out = d;
+	return 0;
+}
+
+int bini_bool(const char *s, size_t n, int *out) {
+	static const char *const yes[] = { "1", "true", "yes", "on" };
+	static const char *const no[]  = { "0", "false", "no", "off" };
+	for (size_t i = 0; i < sizeof(yes) / sizeof(*yes); i++) {
+		if (bini_eqi(s, n, yes[i])) { *out = 1; return 0; }
+		if (bini_eqi(s, n, no[i]))  { *out = 0; return 0; }
+	}
+	return bini_fail(EINVAL);
+}
+
+struct bini_unit {
+	const char *name;
+	uint64_t mul;
+};
+
+// an unsigned decimal integer, optional whitespace, then one of units
+static int bini_scan_unit(const char *s, size_t n, const struct bini_unit *units, size_t nunits, uint64_t *out) {
+	const char *p = s, *end = s + n;
+	uint64_t v;
+	if (bini_scan_uint(&p, end, &v, false)) return -1;
+	while (p < end && bini_isws(*p)) p++;
+	for (size_t i = 0; i < nunits; i++) {
+		if (!bini_eqi(p, end - p, units[i].name)) continue;
+		if (v > UINT64_MAX / units[i].mul) return bini_fail(ERANGE);
+		*out = v * units[i].mul;
+		return 0;
+	}
+	return bini_fail(EINVAL);
+}
+
+int bini_duration(const char *s, size_t n, int64_t *out) {
+	static const struct bini_unit units[] = {
+		{ "ns", 1 }, { "us", 1000 }, { "\xc2\xb5s", 1000 }, { "ms", 1000000 },
+		{ "", 1000000000 }, { "s", 1000000000 }, { "m", 60000000000 },
+		{ "h", 3600000000000 }, { "d", 86400000000000 },
+	};
+	uint64_t v;
+	if (bini_scan_unit(s, n, units, sizeof(units) / sizeof(*units), &v)) return -1;
+	if (v > INT64_MAX) return bini_fail(ERANGE);
+	*out = v;
+	return 0;
+}
+
+int bini_size(const char *s, size_t n, uint64_t *out) {
+	static const struct bini_unit units[] = {
+		{ "", 1 }, { "b", 1 },
+		{ "k", 1ull << 10 }, { "kib", 1ull << 10 }, { "kb", 1000ull },
+		{ "m", 1ull << 20 }, { "mib", 1ull << 20 }, { "mb", 1000000ull },
+		{ "g", 1ull << 30 }, { "gib", 1ull << 30 }, { "gb", 1000000000ull },
+		{ "t", 1ull << 40 }, { "tib", 1ull << 40 }, { "tb", 1000000000000ull },
+		{ "p", 1ull << 50 }, { "pib", 1ull << 50 }, { "pb", 1000000000000000ull },
+		{ "e", 1ull << 60 }, { "eib", 1ull << 60 }, { "eb", 1000000000000000000ull },
+	};
+	return bini_scan_unit(s, n, units, sizeof(units) / sizeof(*units), out);
+}
+
+// == cached typed values
+int bini_doc_int(const struct bini_doc *doc, const char *section, const char *key, int64_t *out) {
+	const char *s = bini_doc_get(doc, section, key);
+	return s ? bini_int(s, strlen(s), out) : bini_fail(ENOENT);
+}
+
+int bini_doc_uint(const struct bini_doc *doc, const char *section, const char *key, uint64_t *out) {
+	const char *s = bini_doc_get(doc, section, key);
+	return s ? bini_uint(s, strlen(s), out) : bini_fail(ENOENT);
+}
+
+int bini_doc_double(const struct bini_doc *doc, const char *section, const char *key, double *out) {
+	const char *s = bini_doc_get(doc, section, key);
+	return s ? bini_double(s, strlen(s), out) : bini_fail(ENOENT);
+}
+
+int bini_doc_bool(const struct bini_doc *doc, const char *section, const char *key, int *out) {
+	const char *s = bini_doc_get(doc, section, key);
+	return s ? bini_bool(s, strlen(s), out) : bini_fail(ENOENT);
+}
+
+int bini_doc_duration(const struct bini_doc *doc, const char *section, const char *key, int64_t *out) {
+	const char *s = bini_doc_get(doc, section, key);
+	return s ? bini_duration(s, strlen(s), out) : bini_fail(ENOENT);
+}
+
+int bini_doc_size(const struct bini_doc *doc, const char *section, const char *key, uint64_t *out) {
+	const char *s = bini_doc_get(doc, section, key);
+	return s ? bini_size(s, strlen(s), out) : bini_fail(ENOENT);
+}
+
+const struct bini_value *bini_doc_ref(struct bini_doc *doc, const char *section, const char *key, enum bini_kind kind) {
+	const struct bini_entry *e = bini_doc_find(doc, section, key);
+	if (!e) {
+		errno = ENOENT;
+		return NULL;
+	}
+	if (!doc->cache && !(doc->cache = calloc(doc->count, sizeof(*doc->cache)))) return NULL;
+	struct bini_value *c = doc->cache + (e - doc->entries), tmp;
+	if (c->kind == kind) return c;
+	if (c->kind != BINI_KIND_NONE) {
+		errno = EEXIST;
+		return NULL;
+	}
+
+	const char *s = doc->data + e->value;
+	size_t n = strlen(s);
+	int err = -1;
+	switch (kind) {
+		case BINI_KIND_INT:      err = bini_int(s, n, &tmp.v.i);      break;
+		case BINI_KIND_UINT:     err = bini_uint(s, n, &tmp.v.u);     break;
+		case BINI_KIND_DOUBLE:   err = bini_double(s, n, &tmp.v.d);   break;
+		case BINI_KIND_BOOL:     err = bini_bool(s, n, &tmp.v.b);     break;
+		case BINI_KIND_DURATION: err = bini_duration(s, n, &tmp.v.i); break;
+		case BINI_KIND_SIZE:     err = bini_size(s, n, &tmp.v.u);     break;
+		case BINI_KIND_NONE:     errno = EINVAL; break;
+	}
+	if (err) return NULL;
+	tmp.kind = kind;
+	*c = tmp;
+	return c;
+}
 #endif // BREAD_INI_IMPLEMENTATION
@@ -4,31 +4,241 @@
 #define BREAD_STDIOX_H
 #include <stdio.h>
 
+// The implementation depends on POSIX.1-2008 (fileno, ftello, fseeko, fstat, mmap, read), see the README.
+
 #ifndef READALL_BUFSIZE
-#define READALL_BUFSIZE 1024
+#define READALL_BUFSIZE 65536
 #endif
 // read from src into dst until hitting EOF
-// dst will be allocated using malloc and realloc, READALL_BUFSIZE at a time
+// dst will be allocated using malloc, and realloc if needed
+// if src is a regular file, dst is sized to fit what's left of it, so it's read in one go
+// otherwise, dst starts out at READALL_BUFSIZE and doubles whenever it fills up
 // does not call fseek, so you can use this with pipes/sockets/etc
-// note that as size increases, this will slow down significantly
+// if an allocation fails, you get what was read up to that point
 size_t readall(char **dst, FILE *src);
+
+// like readall, but if src is a regular file, dst is a private mapping of what's left of it
+// nothing is read until you touch it, and writing to dst does not change the file
+// src is left at EOF, and dst must be released with readall_unmap, not free
+// if src can't be mapped (e.g. it's a pipe, or there's nothing left), dst is set to NULL and 0 is returned:
+// use readall instead
+size_t readall_map(char **dst, FILE *src);
+void readall_unmap(char *dst, size_t n);
+
+#ifndef BLINE_BUFSIZE
+#define BLINE_BUFSIZE 65536
+#endif
+// hands out the lines of a FILE or file descriptor as spans into an internal buffer
+// the buffer is refilled BLINE_BUFSIZE bytes (or more) at a time, and newlines are found with memchr
+// a line is only moved when it crosses the end of the buffer,
+// and the buffer only grows when a line takes up more than half of it
+// note that reading from a FILE uses fread, which waits for a full block:
+// if you want lines from a pipe as soon as they arrive, use a file descriptor
+struct bline_reader {
+	FILE *file;
+	int fd;
+	char *buf;
+	size_t cap, start, end;
+	int eof, err; // err is an errno value
+};
+void bline_init(struct bline_reader *r, FILE *file);
+void bline_initfd(struct bline_reader *r, int fd);
+// returns 1 and sets line and len to the next line (without the newline), which is valid until the next call
+// only \n ends a line, so with CRLF input the \r is left at the end of it
+// the final line is returned even if it doesn't end in a newline
+// returns 0 at EOF, or if reading failed, in which case r->err is set
+int bline_next(struct bline_reader *r, const char **line, size_t *len);
+void bline_free(struct bline_reader *r);
+
+#ifdef BREAD_STATS
+// Counters for the whole program, see the README.
+struct stdiox_stats {
+	unsigned long long calls;    // calls to readall
+	unsigned long long bytes;    // bytes returned by readall and readall_map
+	unsigned long long reallocs; // buffer growths in readall and bline_reader
+	unsigned long long maps;     // successful readall_map calls
+	unsigned long long refills;  // reads done by bline_reader
+	unsigned long long ns;       // time spent in readall
+};
+void stdiox_stats(struct stdiox_stats *out);
+#endif
 #endif // BREAD_STDIOX_H
 
 // = implementation
 #ifdef BREAD_STDIOX_IMPLEMENTATION
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef BREAD_TRACE
+#define BREAD_TRACE(name, n) ((void)0)
+#endif
+
+#ifdef BREAD_STATS
+#include <time.h>
+static struct stdiox_stats stdiox_counters;
+#define STDIOX_STAT(field, n) (stdiox_counters.field += (n))
+
+static unsigned long long stdiox_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void stdiox_stats(struct stdiox_stats *out) {
+	*out = stdiox_counters;
+}
+#else
+#define STDIOX_STAT(field, n) ((void)0)
+#endif
+
+// how many bytes are left in src, or 0 if it isn't a regular file (or that doesn't fit in a size_t)
+static size_t stdiox_remaining(FILE *src) {
+	struct stat st;
+	off_t pos;
+	if (fstat(fileno(src), &st) || !S_ISREG(st.st_mode)) return 0;
+	if ((pos = ftello(src)) < 0 || st.st_size <= pos) return 0;
+	if ((uintmax_t)(st.st_size - pos) > SIZE_MAX) return 0;
+	return st.st_size - pos;
+}
 
 size_t readall(char **dst, FILE *src) {
-	size_t size = READALL_BUFSIZE, read = 0;
+#ifdef BREAD_STATS
+	unsigned long long start = stdiox_now();
+#endif
+	// the +1 lets us see EOF without having to grow
+	size_t size = stdiox_remaining(src) + 1, read = 0, n;
+	if (size < READALL_BUFSIZE) size = READALL_BUFSIZE;
 	*dst = malloc(size);
-	while(!feof(src)) {
-		if (size - read < READALL_BUFSIZE) {
-			size = (size - read) + READALL_BUFSIZE;
-			*dst = realloc(*dst, size);
+	if (!*dst) return 0;
+	for (;;) {
+		if (read == size) {
+			char *tmp = realloc(*dst, size * 2);
+			if (!tmp) break;
+			*dst = tmp;
+			size *= 2;
+			STDIOX_STAT(reallocs, 1);
 		}
-		read += fread((*dst) + read, 1, READALL_BUFSIZE, src);
+		n = fread((*dst) + read, 1, size - read, src);
+		read += n;
+		// a short read means EOF or an error
+		if (read < size) break;
 	}
+	STDIOX_STAT(calls, 1);
+	STDIOX_STAT(bytes, read);
+#ifdef BREAD_STATS
+	STDIOX_STAT(ns, stdiox_now() - start);
+#endif
+	BREAD_TRACE("readall", read);
 	return read;
 }
+
+size_t readall_map(char **dst, FILE *src) {
+	size_t n = stdiox_remaining(src);
+	*dst = NULL;
+	if (!n) return 0;
+	// mappings have to start on a page boundary
+	off_t pos  = ftello(src);
+	off_t skew = pos % sysconf(_SC_PAGESIZE);
+	char *map  = mmap(NULL, n + skew, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(src), pos - skew);
+	if (map == MAP_FAILED) return 0;
+	fseeko(src, 0, SEEK_END);
+	*dst = map + skew;
+	STDIOX_STAT(maps, 1);
+	STDIOX_STAT(bytes, n);
+	BREAD_TRACE("readall_map", n);
+	return n;
+}
+
+void readall_unmap(char *dst, size_t n) {
+	size_t skew = (uintptr_t)dst % sysconf(_SC_PAGESIZE);
+	munmap(dst - skew, n + skew);
+}
+
+void bline_init(struct bline_reader *r, FILE *file) {
+	memset(r, 0, sizeof(*r));
+	r->file = file;
+	r->fd   = -1;
+}
+
+void bline_initfd(struct bline_reader *r, int fd) {
+	memset(r, 0, sizeof(*r));
+	r->fd = fd;
+}
+
+// move the partial line to the front of the buffer, and read as much as fits after it
+static void bline_fill(struct bline_reader *r) {
+	size_t part = r->end - r->start;
+	if (part) memmove(r->buf, r->buf + r->start, part);
+	r->start = 0;
+	r->end   = part;
+	if (!r->cap || part > r->cap / 2) {
+		size_t cap = r->cap ? r->cap * 2 : BLINE_BUFSIZE;
+		char *buf = realloc(r->buf, cap);
+		if (!buf) {
+			r->err = ENOMEM;
+			r->eof = 1;
+			return;
+		}
+		r->buf = buf;
+		r->cap = cap;
+		STDIOX_STAT(reallocs, 1);
+	}
+	STDIOX_STAT(refills, 1);
+
+	if (r->file) {
+		size_t n = fread(r->buf + r->end, 1, r->cap - r->end, r->file);
+		r->end += n;
+		BREAD_TRACE("bline_fill", n);
+		if (!n) {
+			r->eof = 1;
+			if (ferror(r->file)) r->err = EIO;
+		}
+		return;
+	}
+	ssize_t n;
+	do n = read(r->fd, r->buf + r->end, r->cap - r->end);
+	while (n < 0 && errno == EINTR);
+	BREAD_TRACE("bline_fill", n);
+	if (n > 0) r->end += n;
+	else {
+		r->eof = 1;
+		if (n < 0) r->err = errno;
+	}
+}
+
+int bline_next(struct bline_reader *r, const char **line, size_t *len) {
+	size_t scanned = 0; // how much of the current line we already know has no newline
+	for (;;) {
+		char *p  = r->buf + r->start;
+		char *nl = r->end > r->start ? memchr(p + scanned, '\n', r->end - r->start - scanned) : NULL;
+		if (nl) {
+			*line = p;
+			*len  = nl - p;
+			r->start = nl + 1 - r->buf;
+			return 1;
+		}
+		scanned = r->end - r->start;
+		if (r->eof) {
+			if (!scanned || r->err) return 0;
+			*line = p;
+			*len  = scanned;
+			r->start = r->end;
+			return 1;
+		}
+		bline_fill(r);
+	}
+}
+
+void bline_free(struct bline_reader *r) {
+	free(r->buf);
+	r->buf = NULL;
+	r->cap = r->start = r->end = 0;
+}
 #endif
@@ -0,0 +1,114 @@
+// when bini_doc_open trusts, refreshes or replaces a snapshot
+// usage:
+//   cc -std=c99 -D_POSIX_C_SOURCE=200809L -o test-doc test/ini/doc.c
+//   ./test-doc
+// creates test-doc.ini and test-doc.snap in the current directory, and removes them when done
+// prints every failing case, and exits with 1 if there were any
+#define BREAD_INI_IMPLEMENTATION
+#include "../../ini.h"
+
+#include <string.h>
+
+static const char *path = "test-doc.ini", *snap = "test-doc.snap";
+static int failed = 0;
+
+static void check(int ok, const char *what) {
+	if (ok) return;
+	printf("FAIL %s\n", what);
+	failed = 1;
+}
+
+static void put(const char *file, const char *data) {
+	FILE *f = fopen(file, "wb");
+	if (!f || fputs(data, f) < 0 || fclose(f)) {
+		perror(file);
+		exit(1);
+	}
+}
+
+// sets the mtime of file, to ns nanoseconds past the epoch
+static void touch(const char *file, uint64_t ns) {
+	struct timespec ts[2] = { { ns / 1000000000u, ns % 1000000000u }, { ns / 1000000000u, ns % 1000000000u } };
+	if (utimensat(AT_FDCWD, file, ts, 0)) {
+		perror(file);
+		exit(1);
+	}
+}
+
+// what the snapshot on disk says about the source
+static struct bini_snap header(void) {
+	struct bini_snap hdr = {0};
+	FILE *f = fopen(snap, "rb");
+	if (f) {
+		if (fread(&hdr, sizeof(hdr), 1, f) != 1) memset(&hdr, 0, sizeof(hdr));
+		fclose(f);
+	}
+	return hdr;
+}
+
+// opens the document, and checks where it came from and what's in it
+static void open_(const char *what, int mapped, const char *want) {
+	struct bini_doc doc;
+	char name[128];
+	int err = bini_doc_open(&doc, path, snap);
+	snprintf(name, sizeof(name), "%s: open", what);
+	check(!err, name);
+	if (!err) {
+		const char *v = bini_doc_get(&doc, "s", "k");
+		snprintf(name, sizeof(name), "%s: %s", what, mapped ? "from the snapshot" : "reparsed");
+		check(doc.mapped == mapped, name);
+		snprintf(name, sizeof(name), "%s: value", what);
+		check(v && !strcmp(v, want), name);
+	}
+	bini_doc_close(&doc);
+}
+
+int main(void) {
+	// an mtime that is clearly older than any snapshot we write
+	const uint64_t old = 1000000000ull * 1000000000u;
+	remove(snap);
+
+	put(path, "[s]\nk = one\n");
+	touch(path, old);
+	open_("no snapshot", 0, "one");
+	struct bini_snap hdr = header();
+	check(hdr.size == 12 && hdr.mtime == old, "no snapshot: written");
+
+	open_("same size and mtime", 1, "one");
+
+	// the same size and mtime are trusted without looking at the contents
+	put(path, "[s]\nk = two\n");
+	touch(path, old);
+	open_("same size and mtime, different contents", 1, "one");
+
+	// unless the snapshot was written in the same tick as the source, which could have changed after it
+	touch(snap, old);
+	open_("snapshot as old as the source", 0, "two");
+
+	// touched, but with the same contents: the snapshot stays, with the new mtime
+	touch(path, old + 1000000000u);
+	open_("touched", 1, "two");
+	hdr = header();
+	check(hdr.mtime == old + 1000000000u, "touched: new mtime written");
+	open_("touched, again", 1, "two");
+
+	put(path, "[s]\nk = three\n");
+	touch(path, old);
+	open_("changed", 0, "three");
+	open_("changed, again", 1, "three");
+
+	put(snap, "not a snapshot at all, but long enough to have a header");
+	open_("corrupt", 0, "three");
+	open_("corrupt, again", 1, "three");
+
+	put(snap, "BINI");
+	open_("truncated", 0, "three");
+
+	remove(snap);
+	open_("missing", 0, "three");
+	check(header().size == 14, "missing: written");
+
+	remove(snap);
+	remove(path);
+	return failed;
+}
@@ -0,0 +1,155 @@
+// edge cases of the typed value conversions, and reading them from a document
+// usage:
+//   cc -std=c99 -D_POSIX_C_SOURCE=200809L -o test-values test/ini/values.c
+//   ./test-values
+// prints every failing case, and exits with 1 if there were any
+#define BREAD_INI_IMPLEMENTATION
+#include "../../ini.h"
+
+#include <errno.h>
+#include <string.h>
+
+static int failed = 0;
+
+static void check(int ok, const char *what, const char *s) {
+	if (ok) return;
+	printf("FAIL %s «%s»\n", what, s);
+	failed = 1;
+}
+
+// err is the expected errno, or 0 for success with the value want
+static void uint_(const char *s, int err, uint64_t want) {
+	uint64_t v = 42;
+	errno = 0;
+	int r = bini_uint(s, strlen(s), &v);
+	if (err) check(r == -1 && errno == err && v == 42, "bini_uint", s);
+	else check(r == 0 && v == want, "bini_uint", s);
+}
+
+static void int_(const char *s, int err, int64_t want) {
+	int64_t v = 42;
+	errno = 0;
+	int r = bini_int(s, strlen(s), &v);
+	if (err) check(r == -1 && errno == err && v == 42, "bini_int", s);
+	else check(r == 0 && v == want, "bini_int", s);
+}
+
+static void double_(const char *s, int err, double want) {
+	double v = 42;
+	errno = 0;
+	int r = bini_double(s, strlen(s), &v);
+	if (err) check(r == -1 && errno == err && v == 42, "bini_double", s);
+	else check(r == 0 && v == want, "bini_double", s);
+}
+
+static void duration(const char *s, int err, int64_t want) {
+	int64_t v = 42;
+	errno = 0;
+	int r = bini_duration(s, strlen(s), &v);
+	if (err) check(r == -1 && errno == err && v == 42, "bini_duration", s);
+	else check(r == 0 && v == want, "bini_duration", s);
+}
+
+static void size(const char *s, int err, uint64_t want) {
+	uint64_t v = 42;
+	errno = 0;
+	int r = bini_size(s, strlen(s), &v);
+	if (err) check(r == -1 && errno == err && v == 42, "bini_size", s);
+	else check(r == 0 && v == want, "bini_size", s);
+}
+
+// the document getters, and handles into a document
+static void doc(void) {
+	static char src[] = "[s]\nport = 0x1f90\nratio = 0.75\ntimeout = 2s\nbad = x\n";
+	struct bini_doc doc;
+	FILE *f = fmemopen(src, sizeof(src) - 1, "r");
+	if (!f || bini_doc_parse(&doc, f)) {
+		check(0, "bini_doc_parse", src);
+		return;
+	}
+	fclose(f);
+
+	uint64_t u = 42;
+	check(!bini_doc_uint(&doc, "s", "port", &u) && u == 8080, "bini_doc_uint", "port");
+	errno = 0;
+	check(bini_doc_uint(&doc, "s", "nope", &u) && errno == ENOENT && u == 8080, "bini_doc_uint", "nope");
+	check(bini_doc_uint(&doc, "s", "bad", &u) && errno == EINVAL, "bini_doc_uint", "bad");
+	check(!doc.cache, "no cache without bini_doc_ref", "");
+
+	const struct bini_value *port = bini_doc_ref(&doc, "s", "port", BINI_KIND_UINT);
+	check(port && port->v.u == 8080, "bini_doc_ref", "port");
+	check(bini_doc_ref(&doc, "s", "port", BINI_KIND_UINT) == port, "bini_doc_ref again", "port");
+	errno = 0;
+	check(!bini_doc_ref(&doc, "s", "port", BINI_KIND_INT) && errno == EEXIST, "bini_doc_ref as another kind", "port");
+	const struct bini_value *ratio = bini_doc_ref(&doc, "s", "ratio", BINI_KIND_DOUBLE);
+	check(ratio && ratio->v.d == 0.75, "bini_doc_ref", "ratio");
+	const struct bini_value *timeout = bini_doc_ref(&doc, "s", "timeout", BINI_KIND_DURATION);
+	check(timeout && timeout->v.i == 2000000000, "bini_doc_ref", "timeout");
+	errno = 0;
+	check(!bini_doc_ref(&doc, "s", "bad", BINI_KIND_BOOL) && errno == EINVAL, "bini_doc_ref", "bad");
+	check(!bini_doc_ref(&doc, "t", "port", BINI_KIND_UINT) && errno == ENOENT, "bini_doc_ref", "t.port");
+	bini_doc_close(&doc);
+}
+
+int main(void) {
+	uint_("0", 0, 0);
+	uint_("+7", 0, 7);
+	uint_("0x1f", 0, 31);
+	uint_("0XFF", 0, 255);
+	uint_("18446744073709551615", 0, UINT64_MAX);
+	uint_("18446744073709551616", ERANGE, 0);
+	uint_("0x10000000000000000", ERANGE, 0);
+	uint_("", EINVAL, 0);
+	uint_("0x", EINVAL, 0);
+	uint_("5 ", EINVAL, 0);
+	uint_(" 5", EINVAL, 0);
+	uint_("5x", EINVAL, 0);
+	uint_("-1", EINVAL, 0);
+
+	int_("-9223372036854775808", 0, INT64_MIN);
+	int_("9223372036854775807", 0, INT64_MAX);
+	int_("9223372036854775808", ERANGE, 0);
+	int_("-9223372036854775809", ERANGE, 0);
+	int_("-0x10", 0, -16);
+	int_("-", EINVAL, 0);
+	int_("-0x", EINVAL, 0);
+	int_("12 apples", EINVAL, 0);
+
+	double_("1.5", 0, 1.5);
+	double_("-.25", 0, -0.25);
+	double_("1e3", 0, 1000);
+	double_("0.1", 0, 0.1);
+	double_("1.7976931348623157e308", 0, 1.7976931348623157e308);
+	double_("2.2250738585072014e-308", 0, 2.2250738585072014e-308);
+	double_("1e999", ERANGE, 0);
+	double_(".", EINVAL, 0);
+	double_("1e", EINVAL, 0);
+	double_("1.5 ", EINVAL, 0);
+	double_("0,5", EINVAL, 0);
+	double_("nan", EINVAL, 0);
+	// longer than the fallback's stack buffer
+	char big[256] = "0.";
+	memset(big + 2, '3', sizeof(big) - 3);
+	double_(big, 0, 1.0 / 3);
+
+	duration("5", 0, 5000000000);
+	duration("5s", 0, 5000000000);
+	duration("10 ms", 0, 10000000);
+	duration("2h", 0, 7200000000000);
+	duration("1d", 0, 86400000000000);
+	duration("106752d", ERANGE, 0);
+	duration("5 parsecs", EINVAL, 0);
+	duration("s", EINVAL, 0);
+
+	size("512", 0, 512);
+	size("4k", 0, 4096);
+	size("4 KiB", 0, 4096);
+	size("4kb", 0, 4000);
+	size("1E", 0, 1ull << 60);
+	size("16E", ERANGE, 0);
+	size("4 kibibytes", EINVAL, 0);
+	size("0x10", EINVAL, 0);
+
+	doc();
+	return failed;
+}
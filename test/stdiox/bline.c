@@ -0,0 +1,80 @@
+// bline_reader over both a FILE and a file descriptor
+// usage:
+//   cc -std=c99 -D_POSIX_C_SOURCE=200809L -o test-bline test/stdiox/bline.c
+//   ./test-bline
+// prints every failing case, and exits with 1 if there were any
+#define BREAD_STDIOX_IMPLEMENTATION
+#include "../../stdiox.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int failed = 0;
+
+static void check(int ok, const char *what, const char *how, size_t i) {
+	if (ok) return;
+	printf("FAIL %s (%s, line %zu)\n", what, how, i);
+	failed = 1;
+}
+
+// every line and the bytes it's made of, the final one has no newline
+struct line {
+	char c;
+	size_t len;
+	const char *eol;
+};
+
+static const struct line lines[] = {
+	{ 'a', 10, "\n" },
+	{ 'b', 10, "\r\n" },
+	{ 0, 0, "\n" },
+	{ 0, 0, "\r\n" },
+	{ 'c', BLINE_BUFSIZE - 1, "\n" },
+	{ 'd', BLINE_BUFSIZE * 3 + 5, "\r\n" }, // has to grow the buffer, twice
+	{ 'e', 1, "\n" },
+	{ 'f', BLINE_BUFSIZE / 2 + 1, "\n" },   // crosses the end of the buffer
+	{ 'g', 7, "" },
+};
+static const size_t nlines = sizeof(lines) / sizeof(*lines);
+
+static void expect(struct bline_reader *r, const char *how) {
+	const char *line;
+	size_t len;
+	for (size_t i = 0; i < nlines; i++) {
+		if (!bline_next(r, &line, &len)) {
+			check(0, "missing line", how, i);
+			return;
+		}
+		// a \r before the newline is part of the line
+		size_t cr = lines[i].eol[0] == '\r';
+		int ok = len == lines[i].len + cr && (!cr || line[len - 1] == '\r');
+		for (size_t j = 0; ok && j < lines[i].len; j++) ok = line[j] == lines[i].c;
+		check(ok, "wrong line", how, i);
+	}
+	check(!bline_next(r, &line, &len) && !r->err, "trailing line", how, nlines);
+}
+
+int main(void) {
+	FILE *f = tmpfile();
+	if (!f) return 1;
+	for (size_t i = 0; i < nlines; i++) {
+		for (size_t j = 0; j < lines[i].len; j++) fputc(lines[i].c, f);
+		fputs(lines[i].eol, f);
+	}
+	if (fflush(f)) return 1;
+
+	struct bline_reader r;
+	rewind(f);
+	bline_init(&r, f);
+	expect(&r, "FILE");
+	bline_free(&r);
+
+	if (lseek(fileno(f), 0, SEEK_SET)) return 1;
+	bline_initfd(&r, fileno(f));
+	expect(&r, "fd");
+	bline_free(&r);
+
+	fclose(f);
+	return failed;
+}
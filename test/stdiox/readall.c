@@ -0,0 +1,63 @@
+// readall and readall_map on a stream that has already been partly read
+// usage:
+//   cc -std=c99 -D_POSIX_C_SOURCE=200809L -o test-readall test/stdiox/readall.c
+//   ./test-readall
+// prints every failing case, and exits with 1 if there were any
+#define BREAD_STDIOX_IMPLEMENTATION
+#include "../../stdiox.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int failed = 0;
+
+static void check(int ok, const char *what, size_t skip) {
+	if (ok) return;
+	printf("FAIL %s after skipping %zu bytes\n", what, skip);
+	failed = 1;
+}
+
+int main(void) {
+	// larger than READALL_BUFSIZE, and not a multiple of the page size
+	size_t len = 3 * READALL_BUFSIZE + 123;
+	char *data = malloc(len);
+	if (!data) return 1;
+	for (size_t i = 0; i < len; i++) data[i] = 'a' + i % 26;
+
+	FILE *f = tmpfile();
+	if (!f || fwrite(data, 1, len, f) != len) return 1;
+
+	size_t skips[] = { 0, 1, 4095, 4096, READALL_BUFSIZE + 7, len - 1, len };
+	for (size_t i = 0; i < sizeof(skips) / sizeof(*skips); i++) {
+		size_t skip = skips[i], n;
+		char *dst, buf[64];
+
+		// partly read through stdio, so that some of it may sit in the FILE's buffer
+		rewind(f);
+		for (size_t left = skip; left; left -= n) {
+			n = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), f);
+			if (!n) return 1;
+		}
+		n = readall(&dst, f);
+		check(dst && n == len - skip && !memcmp(dst, data + skip, n), "readall", skip);
+		check(feof(f), "readall eof", skip);
+		free(dst);
+
+		rewind(f);
+		for (size_t left = skip; left; left -= n) {
+			n = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), f);
+			if (!n) return 1;
+		}
+		n = readall_map(&dst, f);
+		if (skip == len) {
+			check(!dst && !n, "readall_map at eof", skip);
+			continue;
+		}
+		check(dst && n == len - skip && !memcmp(dst, data + skip, n), "readall_map", skip);
+		if (dst) readall_unmap(dst, n);
+	}
+
+	fclose(f);
+	free(data);
+	return failed;
+}